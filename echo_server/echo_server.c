@@ -19,10 +19,50 @@
 #include <sys/wait.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <errno.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
 #include "thread_pool.h"
+#include "shm_ring.h"
 
 
 
+/*-----------------------------------*/
+/* 宏定义                            */
+/*-----------------------------------*/
+#define ECHO_SERVER_PORT        8000
+#define ECHO_FRAME_HDR_LEN      4                   /* 帧头: 4字节网络序负载长度 */
+#define ECHO_FRAME_MAX_LEN      (16 * 1024)         /* 单帧负载最大长度 */
+#define ECHO_FRAME_BUF_LEN      (64 * 1024)         /* 分帧模式收发缓冲区大小 */
+
+/*-----------------------------------*/
+/* 数据结构定义                       */
+/*-----------------------------------*/
+/* 传输方式 */
+typedef enum _echo_transport_t_
+{
+    ECHO_TRANSPORT_TCP = 0,     /* TCP 0.0.0.0:8000 */
+    ECHO_TRANSPORT_UNIX,        /* unix域套接字 */
+    ECHO_TRANSPORT_SHM_RING     /* unix域套接字握手 + 共享内存环 */
+} echo_transport_t;
+
+/* 客户端连接 */
+typedef struct _echo_client_t_
+{
+    int sock;               /* 客户端套接字，必须为第一个成员 */
+    shm_ring_conn_t *ring;  /* 共享内存环，不使用时为NULL */
+} echo_client_t;
+
+/*-----------------------------------*/
+/* 变量定义                          */
+/*-----------------------------------*/
+static echo_transport_t gs_transport = ECHO_TRANSPORT_TCP;
+static const char *gs_unix_path = NULL;
+static int gs_framed = 0;   /* 1: 长度前缀分帧协议 */
+static const char *gs_trace_path = NULL;    /* 任务跟踪输出文件，NULL表示不跟踪 */
+static int gs_exit_pipe[2] = {-1, -1};  /* 收到ctrl+c时信号处理函数写入一个字节，唤醒主线程退出 */
+
 
 /*****************************************************************************
  * 函  数:    echo_server_error_exit
@@ -42,18 +82,53 @@ static void echo_server_error_exit(const char *error)
 
 /*****************************************************************************
  * 函  数:    echo_server_startup
- * 功  能:    创建TCP服务监听
+ * 功  能:    创建服务监听
  * 输  入:    无
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai(DTT)
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 支持unix域套接字监听
  ****************************************************************************/
 static int echo_server_startup(void)
 {
     int server_sock = -1;
     int on = 1;
     struct sockaddr_in server_addr;
+    struct sockaddr_un unix_addr;
+
+    /* 本机客户端走unix域套接字，不经过TCP协议栈 */
+    if (ECHO_TRANSPORT_TCP != gs_transport)
+    {
+        server_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (-1 == server_sock)
+        {
+            return -1;
+        }
+
+        memset(&unix_addr, 0x00, sizeof(unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        if (strlen(gs_unix_path) >= sizeof(unix_addr.sun_path))
+        {
+            printf("unix socket path too long: %s\n", gs_unix_path);
+            exit(1);
+        }
+        strcpy(unix_addr.sun_path, gs_unix_path);
+        unlink(gs_unix_path);
+
+        /* bind */
+        if (bind(server_sock, (struct sockaddr *)&unix_addr, sizeof(unix_addr)) < 0)
+        {
+            echo_server_error_exit("bind failed");
+        }
+
+        /* listen */
+        if (listen(server_sock, 5) < 0)
+        {
+            echo_server_error_exit("listen failed");
+        }
+
+        return (server_sock);
+    }
 
     server_sock = socket(PF_INET, SOCK_STREAM, 0);
     if (-1 == server_sock)
@@ -64,7 +139,7 @@ static int echo_server_startup(void)
 
     memset(&server_addr, 0x00, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(8000);
+    server_addr.sin_port = htons(ECHO_SERVER_PORT);
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
     /* 设置socket属性 */
@@ -88,6 +163,88 @@ static int echo_server_startup(void)
     return (server_sock);
 }
 
+/*****************************************************************************
+ * 函  数:    echo_server_client_recv
+ * 功  能:    从客户端接收数据
+ * 输  入:    client: 客户端连接
+ *            buf:    接收缓冲区
+ *            len:    缓冲区长度
+ * 输  出:    无
+ * 返回值:    返回接收的字节数，对端退出返回0，出错返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static ssize_t echo_server_client_recv(echo_client_t *client, void *buf, size_t len)
+{
+    if (NULL != client->ring)
+    {
+        return shm_ring_read(client->ring, buf, len);
+    }
+
+    return recv(client->sock, buf, len, 0);
+}
+
+/*****************************************************************************
+ * 函  数:    echo_server_client_send
+ * 功  能:    向客户端发送数据
+ * 输  入:    client: 客户端连接
+ *            buf:    待发送数据
+ *            len:    数据长度
+ * 输  出:    无
+ * 返回值:    全部发送返回len，出错返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static ssize_t echo_server_client_send(echo_client_t *client, const void *buf, size_t len)
+{
+    size_t sent = 0;
+    ssize_t nbytes = 0;
+
+    if (NULL != client->ring)
+    {
+        return shm_ring_write(client->ring, buf, len);
+    }
+
+    /* 合并后的应答可能较大，循环直到全部写完 */
+    while (sent < len)
+    {
+        nbytes = write(client->sock, (const char *)buf + sent, len - sent);
+        if (nbytes <= 0)
+        {
+            return -1;
+        }
+        sent += nbytes;
+    }
+
+    return (ssize_t)len;
+}
+
+/*****************************************************************************
+ * 函  数:    echo_server_client_close
+ * 功  能:    关闭客户端连接
+ * 输  入:    client: 客户端连接
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void echo_server_client_close(echo_client_t *client)
+{
+    printf("客户端%d 退出\n", (client->sock - 3));
+
+    if (NULL != client->ring)
+    {
+        /* 同时关闭控制套接字 */
+        shm_ring_close(client->ring);
+    }
+    else
+    {
+        close(client->sock);
+    }
+
+    free(client);
+}
+
 /*****************************************************************************
  * 函  数:    echo_server_accpet_client_request
  * 功  能:    处理客户端请求
@@ -95,11 +252,11 @@ static int echo_server_startup(void)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai(DTT)
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 支持共享内存环传输
  ****************************************************************************/
 void *echo_server_accpet_client_request(void *arg)
 {
-    int client_sock = *(int *)arg;
+    echo_client_t *client = (echo_client_t *)arg;
     int nbytes = 0;
     char buf[256] = {0};
 
@@ -107,18 +264,16 @@ void *echo_server_accpet_client_request(void *arg)
     while(1)
     {
         /* 接收客户端数据并原样返回给客户端 */
-        nbytes = recv(client_sock, buf, sizeof(buf) - 1, 0);
+        nbytes = echo_server_client_recv(client, buf, sizeof(buf) - 1);
         if (nbytes > 0)
         {
             buf[nbytes] = '\0';
-            write(client_sock, buf, nbytes);
+            echo_server_client_send(client, buf, nbytes);
         }
         else
         {
-            /* 对端客户端退出，关闭客户端套接字 */
-            close(client_sock);
-            printf("客户端%d 退出\n", (client_sock - 3));
-            free(arg);
+            /* 对端客户端退出，关闭客户端连接 */
+            echo_server_client_close(client);
             break;
         }
         
@@ -127,29 +282,199 @@ void *echo_server_accpet_client_request(void *arg)
     return NULL;
 }
 
+/*****************************************************************************
+ * 函  数:    echo_server_frame_handle
+ * 功  能:    处理一个请求帧，生成应答帧(回显负载)
+ * 输  入:    payload: 请求负载
+ *            len:     负载长度
+ *            out:     应答写入位置，调用者保证至少有ECHO_FRAME_HDR_LEN + len空间
+ * 输  出:    无
+ * 返回值:    返回应答帧长度
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static size_t echo_server_frame_handle(const char *payload, uint32_t len, char *out)
+{
+    uint32_t net_len = htonl(len);
+
+    memcpy(out, &net_len, ECHO_FRAME_HDR_LEN);
+    memcpy(out + ECHO_FRAME_HDR_LEN, payload, len);
+
+    return ECHO_FRAME_HDR_LEN + len;
+}
+
+/*****************************************************************************
+ * 函  数:    echo_server_framed_client_request
+ * 功  能:    分帧协议处理客户端请求: 每次读取后解析出所有完整的帧，
+ *            应答合并到一次写中发回，支持客户端流水线发送多个请求
+ * 输  入:    arg: 客户端连接
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void *echo_server_framed_client_request(void *arg)
+{
+    echo_client_t *client = (echo_client_t *)arg;
+    char *in = NULL;
+    char *out = NULL;
+    size_t in_len = 0;
+    size_t out_len = 0;
+    size_t pos = 0;
+    uint32_t frame_len = 0;
+    ssize_t nbytes = 0;
+
+    in = (char *)malloc(ECHO_FRAME_BUF_LEN);
+    out = (char *)malloc(ECHO_FRAME_BUF_LEN);
+    if ((NULL == in) || (NULL == out))
+    {
+        free(in);
+        free(out);
+        echo_server_client_close(client);
+        return NULL;
+    }
+
+    while(1)
+    {
+        nbytes = echo_server_client_recv(client, in + in_len, ECHO_FRAME_BUF_LEN - in_len);
+        if (nbytes <= 0)
+        {
+            /* 对端客户端退出 */
+            break;
+        }
+        in_len += nbytes;
+
+        /* 解析缓冲区中所有完整的帧 */
+        pos = 0;
+        out_len = 0;
+        while (in_len - pos >= ECHO_FRAME_HDR_LEN)
+        {
+            memcpy(&frame_len, in + pos, ECHO_FRAME_HDR_LEN);
+            frame_len = ntohl(frame_len);
+            if (frame_len > ECHO_FRAME_MAX_LEN)
+            {
+                printf("客户端%d 帧长度%u 超过上限\n", (client->sock - 3), frame_len);
+                goto out;
+            }
+
+            if (in_len - pos < ECHO_FRAME_HDR_LEN + frame_len)
+            {
+                /* 帧不完整，等待后续数据 */
+                break;
+            }
+
+            /* 应答缓冲区放不下时先发出去 */
+            if (out_len + ECHO_FRAME_HDR_LEN + frame_len > ECHO_FRAME_BUF_LEN)
+            {
+                if (-1 == echo_server_client_send(client, out, out_len))
+                {
+                    goto out;
+                }
+                out_len = 0;
+            }
+
+            out_len += echo_server_frame_handle(in + pos + ECHO_FRAME_HDR_LEN, frame_len, out + out_len);
+            pos += ECHO_FRAME_HDR_LEN + frame_len;
+        }
+
+        /* 本次读到的所有应答合并为一次写 */
+        if ((out_len > 0) && (-1 == echo_server_client_send(client, out, out_len)))
+        {
+            break;
+        }
+
+        /* 剩余的不完整帧移到缓冲区头部 */
+        in_len -= pos;
+        memmove(in, in + pos, in_len);
+    }
+
+out:
+    free(in);
+    free(out);
+    echo_server_client_close(client);
+
+    return NULL;
+}
+
 /*****************************************************************************
  * 函  数:    sigint_handler
- * 功  能:    ctrl+c信号处理
+ * 功  能:    ctrl+c信号处理，只向退出管道写一个字节，退出流程在主线程中执行
  * 输  入:    无
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai(DTT)
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 退出流程移到echo_server_shutdown
+ *            2026-10-19 changzehai 通过自管道通知主线程，避免检查标识与accept之间丢失信号
  ****************************************************************************/
 void sigint_handler(int signum)
 {
+    int saved_errno = errno;
+    ssize_t ret = 0;
+
     (void)signum;
 
+    /* 管道为非阻塞，已满说明主线程尚未处理上一次通知，忽略即可 */
+    ret = write(gs_exit_pipe[1], "x", 1);
+    (void)ret;
+
+    errno = saved_errno;
+}
+
+/*****************************************************************************
+ * 函  数:    echo_server_shutdown
+ * 功  能:    退出服务器: 输出任务跟踪，销毁线程池，删除unix域套接字文件。
+ *            这些操作都不是异步信号安全的，只能在主线程中调用
+ * 输  入:    无
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void echo_server_shutdown(void)
+{
     printf("接收到服务器退出信号，服务器开始退从...\n");
 
+    /* 输出任务跟踪 */
+    if (NULL != gs_trace_path)
+    {
+        thread_pool_trace_dump(gs_trace_path);
+        printf("任务跟踪已写入%s\n", gs_trace_path);
+    }
+
     /* 销毁线程池 */
     thread_pool_destory();
 
+    /* 删除unix域套接字文件 */
+    if (NULL != gs_unix_path)
+    {
+        unlink(gs_unix_path);
+    }
+
     printf("服务器退出完毕!\n");
     exit(0);
 }
 
 
+/*****************************************************************************
+ * 函  数:    echo_server_usage
+ * 功  能:    打印命令行用法并退出
+ * 输  入:    prog: 程序名
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void echo_server_usage(const char *prog)
+{
+    printf("用法: %s [-u unix_path | -r unix_path] [-f] [-t trace.json]\n", prog);
+    printf("  (无参数)      监听TCP 0.0.0.0:%d\n", ECHO_SERVER_PORT);
+    printf("  -u unix_path  监听unix域套接字\n");
+    printf("  -r unix_path  监听unix域套接字，连接后通过共享内存环收发数据\n");
+    printf("  -f            使用长度前缀分帧协议，支持请求流水线\n");
+    printf("  -t trace.json 跟踪线程池任务，退出时输出Chrome/Perfetto格式跟踪文件\n");
+    exit(1);
+}
+
 /*****************************************************************************
  * 函  数:    main
  * 功  能:    主函数
@@ -157,22 +482,67 @@ void sigint_handler(int signum)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai(DTT)
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 增加unix域套接字和共享内存环传输选项
+ *            2026-10-19 changzehai 增加分帧协议选项
+ *            2026-10-19 changzehai 增加任务跟踪选项
+ *            2026-10-19 changzehai ctrl+c退出流程在主线程执行
+ *            2026-10-19 changzehai 主线程同时等待监听套接字和退出管道
  ****************************************************************************/
-int main()
+int main(int argc, char *argv[])
 {
     int server_sock = -1;
     int client_sock = -1;
+    int opt = 0;
     socklen_t client_addr_len = 0;
-    struct sockaddr_in client_addr;
+    struct sockaddr_storage client_addr;
+    echo_client_t *client = NULL;
+    struct sigaction sa;
+    sigset_t sigint_set;
+    struct pollfd fds[2];
 
 
+    while (-1 != (opt = getopt(argc, argv, "u:r:ft:")))
+    {
+        switch (opt)
+        {
+            case 'u':
+                gs_transport = ECHO_TRANSPORT_UNIX;
+                gs_unix_path = optarg;
+                break;
+            case 'r':
+                gs_transport = ECHO_TRANSPORT_SHM_RING;
+                gs_unix_path = optarg;
+                break;
+            case 'f':
+                gs_framed = 1;
+                break;
+            case 't':
+                gs_trace_path = optarg;
+                break;
+            default:
+                echo_server_usage(argv[0]);
+        }
+    }
+
+    /* 创建退出管道，信号处理函数和主线程都不能阻塞在管道上 */
+    if ((0 != pipe(gs_exit_pipe)) ||
+        (-1 == fcntl(gs_exit_pipe[0], F_SETFL, O_NONBLOCK)) ||
+        (-1 == fcntl(gs_exit_pipe[1], F_SETFL, O_NONBLOCK)) ||
+        (-1 == fcntl(gs_exit_pipe[0], F_SETFD, FD_CLOEXEC)) ||
+        (-1 == fcntl(gs_exit_pipe[1], F_SETFD, FD_CLOEXEC)))
+    {
+        echo_server_error_exit("pipe");
+    }
 
-    client_addr_len = sizeof(client_addr);
-    memset(&client_addr, 0x00, sizeof(client_addr));
+    /* 监听ctrl+c信号，不设SA_RESTART，让主线程的poll/accept被中断后检查退出管道 */
+    memset(&sa, 0x00, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
 
-    /* 监听ctrl+c信号 */
-    signal(SIGINT, sigint_handler);
+    /* 对端退出后写套接字不应杀死服务器 */
+    signal(SIGPIPE, SIG_IGN);
 
     /* 启动server socket */
     server_sock = echo_server_startup();
@@ -181,7 +551,25 @@ int main()
         echo_server_error_exit("socket failed");
     }
 
-    printf("echo server running on 8000 !!!\n");
+    if (ECHO_TRANSPORT_TCP == gs_transport)
+    {
+        printf("echo server running on %d !!!\n", ECHO_SERVER_PORT);
+    }
+    else
+    {
+        printf("echo server running on %s (%s) !!!\n", gs_unix_path,
+               (ECHO_TRANSPORT_UNIX == gs_transport) ? "unix" : "shm ring");
+    }
+
+    if (NULL != gs_trace_path)
+    {
+        thread_pool_trace_enable(0);
+    }
+
+    /* 工作线程屏蔽SIGINT，保证信号只投递到主线程 */
+    sigemptyset(&sigint_set);
+    sigaddset(&sigint_set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigint_set, NULL);
 
     /* 初始化线程池 */
     if (-1 == thread_pool_init(4))
@@ -189,28 +577,80 @@ int main()
         echo_server_error_exit("thread pool init failed"); 
     }
 
+    pthread_sigmask(SIG_UNBLOCK, &sigint_set, NULL);
+
     /* 打印创建的线程ID */   
     thread_pool_worker_id_print();
 
 
+    fds[0].fd = server_sock;
+    fds[0].events = POLLIN;
+    fds[1].fd = gs_exit_pipe[0];
+    fds[1].events = POLLIN;
+
     while (1)
     {
-        /* 接受客户端连接 */
+        /* 同时等待新连接和退出管道: 任何时刻收到的信号都会使管道可读，不会丢失 */
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            echo_server_error_exit("poll");
+        }
+
+        if (0 != (fds[1].revents & POLLIN))
+        {
+            echo_server_shutdown();
+        }
+
+        if (0 == (fds[0].revents & POLLIN))
+        {
+            continue;
+        }
+
+        /* 接受客户端连接，期间收到信号被中断时回到poll处理退出 */
+        client_addr_len = sizeof(client_addr);
         client_sock = accept(server_sock,
                           (struct sockaddr *)&client_addr,
                           &client_addr_len);
         if (-1 == client_sock)
         {
+            if ((EINTR == errno) || (ECONNABORTED == errno))
+            {
+                continue;
+            }
             echo_server_error_exit("accept");
         }
         printf("客户端%d 上线\n", (client_sock - 3));
 
-        void *arg = (int *)malloc(sizeof(client_sock));
-        *(int *)arg = client_sock;
+        client = (echo_client_t *)malloc(sizeof(echo_client_t));
+        if (NULL == client)
+        {
+            close(client_sock);
+            continue;
+        }
+        client->sock = client_sock;
+        client->ring = NULL;
 
+        /* 共享内存环方式: 创建环并把描述符交给客户端，之后由线程池服务环 */
+        if (ECHO_TRANSPORT_SHM_RING == gs_transport)
+        {
+            if (-1 == shm_ring_server_accept(client_sock, &client->ring))
+            {
+                close(client_sock);
+                free(client);
+                continue;
+            }
+        }
 
         /* 添加客户端请求任务到线程池中处理 */
-        if (-1 == thread_pool_add_task(echo_server_accpet_client_request, arg))
+        if (-1 == thread_pool_add_task_labeled((1 == gs_framed) ? echo_server_framed_client_request :
+                                                                  echo_server_accpet_client_request,
+                                               client, "client"))
         {
             perror("thread_pool_add_task failed");
         }
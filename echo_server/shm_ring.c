@@ -0,0 +1,601 @@
+/*****************************************************************************/
+/* 文件名:    shm_ring.c                                                     */
+/* 描  述:    本机客户端共享内存环形缓冲区传输(memfd + eventfd)               */
+/*            服务器为每个连接创建memfd共享内存和eventfd门铃，通过unix域       */
+/*            套接字(SCM_RIGHTS)传给客户端，之后的数据收发完全不经过内核协议栈  */
+/* 创  建:    2026-10-19 changzehai                                          */
+/* 更  新:    无                                                             */
+/* Copyright 1998 - 2020 CZH. All Rights Reserved                            */
+/*****************************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include "shm_ring.h"
+
+
+
+
+/*-----------------------------------*/
+/* 宏定义                            */
+/*-----------------------------------*/
+#define SHM_RING_FD_NUM     5   /* memfd + 4个eventfd */
+
+/*-----------------------------------*/
+/* 内部函数声明                       */
+/*-----------------------------------*/
+static shm_ring_conn_t *shm_ring_conn_new(int ctrl_sock);
+static void shm_ring_init(shm_ring_t *ring);
+static int shm_ring_wait(shm_ring_conn_t *conn, int efd);
+static void shm_ring_notify(uint32_t *waiting, int efd);
+static void shm_ring_close_received_fds(struct msghdr *msg);
+
+/*****************************************************************************
+ * 函  数:    shm_ring_conn_new
+ * 功  能:    分配并初始化连接结构
+ * 输  入:    ctrl_sock: 控制用unix域套接字
+ * 输  出:    无
+ * 返回值:    成功返回连接，失败返回NULL
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static shm_ring_conn_t *shm_ring_conn_new(int ctrl_sock)
+{
+    shm_ring_conn_t *conn = NULL;
+
+    conn = (shm_ring_conn_t *)malloc(sizeof(shm_ring_conn_t));
+    if (NULL == conn)
+    {
+        printf("shm_ring_conn_new() malloc failed\n");
+        return NULL;
+    }
+
+    conn->ctrl_sock = ctrl_sock;
+    conn->mem_fd = -1;
+    conn->base = MAP_FAILED;
+    conn->rx = NULL;
+    conn->tx = NULL;
+    conn->rx_data_efd = -1;
+    conn->rx_space_efd = -1;
+    conn->tx_data_efd = -1;
+    conn->tx_space_efd = -1;
+
+    return conn;
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_init
+ * 功  能:    初始化环形缓冲区
+ * 输  入:    ring: 环形缓冲区
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void shm_ring_init(shm_ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->data_waiting = 0;
+    ring->space_waiting = 0;
+    ring->size = SHM_RING_SIZE;
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_wait
+ * 功  能:    阻塞等待门铃，同时检测对端是否已经退出
+ * 输  入:    conn: 连接
+ *            efd:  等待的eventfd门铃
+ * 输  出:    无
+ * 返回值:    门铃响返回0，对端退出、控制套接字收到数据或出错返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static int shm_ring_wait(shm_ring_conn_t *conn, int efd)
+{
+    struct pollfd fds[2];
+    eventfd_t value = 0;
+    char c = 0;
+
+    fds[0].fd = efd;
+    fds[0].events = POLLIN;
+    fds[1].fd = conn->ctrl_sock;
+    fds[1].events = POLLIN;
+
+    while (1)
+    {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        if (0 != (fds[0].revents & POLLIN))
+        {
+            /* 门铃为非阻塞，计数已被清空时返回EAGAIN，调用者会重新检查环 */
+            eventfd_read(efd, &value);
+            return 0;
+        }
+
+        /* 握手后控制套接字上不应再有数据: 可读表示对端关闭，收到数据视为协议错误 */
+        if (0 != fds[1].revents)
+        {
+            if ((recv(conn->ctrl_sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0) &&
+                ((EAGAIN == errno) || (EINTR == errno)))
+            {
+                continue;
+            }
+            return -1;
+        }
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_notify
+ * 功  能:    对端正在等待时敲门铃，对端忙时不产生系统调用
+ * 输  入:    waiting: 对端等待标识
+ *            efd:     门铃
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void shm_ring_notify(uint32_t *waiting, int efd)
+{
+    /* 与等待方"先置等待标识再检查"配对，保证不会丢失唤醒 */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((0 != __atomic_load_n(waiting, __ATOMIC_SEQ_CST)) &&
+        (0 != __atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST)))
+    {
+        /* 门铃为非阻塞: 计数饱和(EAGAIN)说明对端已有未处理的唤醒，
+           不能因此阻塞服务器线程 */
+        eventfd_write(efd, 1);
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_close_received_fds
+ * 功  能:    关闭recvmsg通过SCM_RIGHTS收到的所有描述符，用于握手失败时
+ * 输  入:    msg: recvmsg返回的消息
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void shm_ring_close_received_fds(struct msghdr *msg)
+{
+    struct cmsghdr *cmsg = NULL;
+    int *fds = NULL;
+    size_t num = 0;
+    size_t i = 0;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); NULL != cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if ((SOL_SOCKET != cmsg->cmsg_level) || (SCM_RIGHTS != cmsg->cmsg_type) ||
+            (cmsg->cmsg_len < CMSG_LEN(0)))
+        {
+            continue;
+        }
+
+        fds = (int *)CMSG_DATA(cmsg);
+        num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (i = 0; i < num; i++)
+        {
+            close(fds[i]);
+        }
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_server_accept
+ * 功  能:    服务器端为新连接创建共享内存环和门铃，并传给客户端
+ * 输  入:    ctrl_sock: accept得到的unix域套接字
+ * 输  出:    conn:      新建的连接
+ * 返回值:    成功返回0，ctrl_sock归conn所有，由shm_ring_close关闭；
+ *            失败返回-1，ctrl_sock仍由调用者关闭
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int shm_ring_server_accept(int ctrl_sock, shm_ring_conn_t **conn)
+{
+    shm_ring_conn_t *new_conn = NULL;
+    shm_ring_t *rings = NULL;
+    int fds[SHM_RING_FD_NUM];
+    char cmsg_buf[CMSG_SPACE(sizeof(fds))];
+    char dummy = 'R';
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg = NULL;
+
+    if (NULL == conn)
+    {
+        printf("shm_ring_server_accept()参数有误,conn为NULL\n");
+        return -1;
+    }
+
+    new_conn = shm_ring_conn_new(ctrl_sock);
+    if (NULL == new_conn)
+    {
+        return -1;
+    }
+
+    /* 创建共享内存: [0]请求环 [1]应答环。封印大小后再交给客户端，
+       防止客户端截断memfd使服务器访问映射时收到SIGBUS */
+    new_conn->mem_fd = memfd_create("echo_shm_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if ((-1 == new_conn->mem_fd) ||
+        (0 != ftruncate(new_conn->mem_fd, 2 * sizeof(shm_ring_t))) ||
+        (0 != fcntl(new_conn->mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)))
+    {
+        perror("memfd");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    new_conn->base = mmap(NULL, 2 * sizeof(shm_ring_t), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, new_conn->mem_fd, 0);
+    if (MAP_FAILED == new_conn->base)
+    {
+        perror("mmap");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    rings = (shm_ring_t *)new_conn->base;
+    shm_ring_init(&rings[0]);
+    shm_ring_init(&rings[1]);
+    new_conn->rx = &rings[0];
+    new_conn->tx = &rings[1];
+
+    /* 创建门铃 */
+    new_conn->rx_data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    new_conn->rx_space_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    new_conn->tx_data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    new_conn->tx_space_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((-1 == new_conn->rx_data_efd) || (-1 == new_conn->rx_space_efd) ||
+        (-1 == new_conn->tx_data_efd) || (-1 == new_conn->tx_space_efd))
+    {
+        perror("eventfd");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    /* 通过SCM_RIGHTS把memfd和门铃传给客户端 */
+    fds[0] = new_conn->mem_fd;
+    fds[1] = new_conn->rx_data_efd;
+    fds[2] = new_conn->rx_space_efd;
+    fds[3] = new_conn->tx_data_efd;
+    fds[4] = new_conn->tx_space_efd;
+
+    memset(&msg, 0x00, sizeof(msg));
+    memset(cmsg_buf, 0x00, sizeof(cmsg_buf));
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg_buf;
+    msg.msg_controllen = sizeof(cmsg_buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(ctrl_sock, &msg, MSG_NOSIGNAL) < 0)
+    {
+        perror("sendmsg");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    *conn = new_conn;
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_client_attach
+ * 功  能:    客户端接收服务器传来的共享内存环和门铃并映射
+ * 输  入:    ctrl_sock: 已连接的unix域套接字
+ * 输  出:    conn:      新建的连接
+ * 返回值:    成功返回0，ctrl_sock归conn所有，由shm_ring_close关闭；
+ *            失败返回-1，ctrl_sock仍由调用者关闭
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int shm_ring_client_attach(int ctrl_sock, shm_ring_conn_t **conn)
+{
+    shm_ring_conn_t *new_conn = NULL;
+    shm_ring_t *rings = NULL;
+    int fds[SHM_RING_FD_NUM];
+    char cmsg_buf[CMSG_SPACE(sizeof(fds))];
+    char dummy = 0;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg = NULL;
+    struct stat st;
+
+    if (NULL == conn)
+    {
+        printf("shm_ring_client_attach()参数有误,conn为NULL\n");
+        return -1;
+    }
+
+    memset(&msg, 0x00, sizeof(msg));
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg_buf;
+    msg.msg_controllen = sizeof(cmsg_buf);
+
+    if (recvmsg(ctrl_sock, &msg, MSG_CMSG_CLOEXEC) <= 0)
+    {
+        perror("recvmsg");
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((0 != (msg.msg_flags & MSG_CTRUNC)) || (NULL == cmsg) ||
+        (SOL_SOCKET != cmsg->cmsg_level) || (SCM_RIGHTS != cmsg->cmsg_type) ||
+        (CMSG_LEN(sizeof(fds)) != cmsg->cmsg_len) || (NULL != CMSG_NXTHDR(&msg, cmsg)))
+    {
+        printf("shm_ring_client_attach() 未收到共享内存描述符\n");
+        shm_ring_close_received_fds(&msg);
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    new_conn = shm_ring_conn_new(ctrl_sock);
+    if (NULL == new_conn)
+    {
+        shm_ring_close_received_fds(&msg);
+        return -1;
+    }
+
+    /* 客户端的收发方向与服务器相反 */
+    new_conn->mem_fd = fds[0];
+    new_conn->tx_data_efd = fds[1];
+    new_conn->tx_space_efd = fds[2];
+    new_conn->rx_data_efd = fds[3];
+    new_conn->rx_space_efd = fds[4];
+
+    if ((0 != fstat(new_conn->mem_fd, &st)) ||
+        ((off_t)(2 * sizeof(shm_ring_t)) != st.st_size))
+    {
+        printf("shm_ring_client_attach() 共享内存大小不匹配\n");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    new_conn->base = mmap(NULL, 2 * sizeof(shm_ring_t), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, new_conn->mem_fd, 0);
+    if (MAP_FAILED == new_conn->base)
+    {
+        perror("mmap");
+        new_conn->ctrl_sock = -1;
+        shm_ring_close(new_conn);
+        return -1;
+    }
+
+    rings = (shm_ring_t *)new_conn->base;
+    new_conn->tx = &rings[0];
+    new_conn->rx = &rings[1];
+
+    *conn = new_conn;
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_read
+ * 功  能:    从rx环读取数据，环为空时阻塞等待
+ * 输  入:    conn: 连接
+ *            buf:  接收缓冲区
+ *            len:  缓冲区长度
+ * 输  出:    无
+ * 返回值:    返回读取的字节数，对端退出返回0，环索引异常返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+ssize_t shm_ring_read(shm_ring_conn_t *conn, void *buf, size_t len)
+{
+    shm_ring_t *ring = conn->rx;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t n = 0;
+    uint32_t off = 0;
+    uint32_t first = 0;
+
+    while (1)
+    {
+        head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        /* 索引在对端可写的共享内存中，先校验再使用 */
+        n = tail - head;
+        if (n > SHM_RING_SIZE)
+        {
+            printf("shm_ring_read() 环索引异常 head=%u tail=%u\n", head, tail);
+            return -1;
+        }
+
+        if (0 != n)
+        {
+            if (n > len)
+            {
+                n = (uint32_t)len;
+            }
+
+            /* 拷贝数据，处理回绕 */
+            off = head & (SHM_RING_SIZE - 1);
+            first = SHM_RING_SIZE - off;
+            if (first > n)
+            {
+                first = n;
+            }
+            memcpy(buf, ring->data + off, first);
+            memcpy((char *)buf + first, ring->data, n - first);
+
+            __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+            shm_ring_notify(&ring->space_waiting, conn->rx_space_efd);
+
+            return n;
+        }
+
+        /* 环为空，先置等待标识再检查一次，然后等门铃 */
+        __atomic_store_n(&ring->data_waiting, 1, __ATOMIC_SEQ_CST);
+        if (head == __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST))
+        {
+            if (-1 == shm_ring_wait(conn, conn->rx_data_efd))
+            {
+                __atomic_store_n(&ring->data_waiting, 0, __ATOMIC_SEQ_CST);
+                return 0;
+            }
+        }
+        __atomic_store_n(&ring->data_waiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_write
+ * 功  能:    向tx环写入全部数据，环满时阻塞等待
+ * 输  入:    conn: 连接
+ *            buf:  待发送数据
+ *            len:  数据长度
+ * 输  出:    无
+ * 返回值:    成功返回len，对端退出或环索引异常返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+ssize_t shm_ring_write(shm_ring_conn_t *conn, const void *buf, size_t len)
+{
+    shm_ring_t *ring = conn->tx;
+    size_t written = 0;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t n = 0;
+    uint32_t off = 0;
+    uint32_t first = 0;
+
+    while (written < len)
+    {
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        /* 索引在对端可写的共享内存中，先校验再使用 */
+        if ((uint32_t)(tail - head) > SHM_RING_SIZE)
+        {
+            printf("shm_ring_write() 环索引异常 head=%u tail=%u\n", head, tail);
+            return -1;
+        }
+
+        n = SHM_RING_SIZE - (tail - head);
+        if (0 != n)
+        {
+            if (n > len - written)
+            {
+                n = (uint32_t)(len - written);
+            }
+
+            /* 拷贝数据，处理回绕 */
+            off = tail & (SHM_RING_SIZE - 1);
+            first = SHM_RING_SIZE - off;
+            if (first > n)
+            {
+                first = n;
+            }
+            memcpy(ring->data + off, (const char *)buf + written, first);
+            memcpy(ring->data, (const char *)buf + written + first, n - first);
+
+            __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+            shm_ring_notify(&ring->data_waiting, conn->tx_data_efd);
+
+            written += n;
+            continue;
+        }
+
+        /* 环已满，先置等待标识再检查一次，然后等门铃 */
+        __atomic_store_n(&ring->space_waiting, 1, __ATOMIC_SEQ_CST);
+        if (head == __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST))
+        {
+            if (-1 == shm_ring_wait(conn, conn->tx_space_efd))
+            {
+                __atomic_store_n(&ring->space_waiting, 0, __ATOMIC_SEQ_CST);
+                return -1;
+            }
+        }
+        __atomic_store_n(&ring->space_waiting, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return (ssize_t)len;
+}
+
+/*****************************************************************************
+ * 函  数:    shm_ring_close
+ * 功  能:    关闭连接，释放共享内存、门铃和控制套接字
+ * 输  入:    conn: 连接
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void shm_ring_close(shm_ring_conn_t *conn)
+{
+    if (NULL == conn)
+    {
+        return;
+    }
+
+    if (MAP_FAILED != conn->base)
+    {
+        munmap(conn->base, 2 * sizeof(shm_ring_t));
+    }
+
+    if (-1 != conn->mem_fd)
+    {
+        close(conn->mem_fd);
+    }
+    if (-1 != conn->rx_data_efd)
+    {
+        close(conn->rx_data_efd);
+    }
+    if (-1 != conn->rx_space_efd)
+    {
+        close(conn->rx_space_efd);
+    }
+    if (-1 != conn->tx_data_efd)
+    {
+        close(conn->tx_data_efd);
+    }
+    if (-1 != conn->tx_space_efd)
+    {
+        close(conn->tx_space_efd);
+    }
+
+    if (-1 != conn->ctrl_sock)
+    {
+        close(conn->ctrl_sock);
+    }
+    free(conn);
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************/
+/* 文件名:    shm_ring.h                                                     */
+/* 描  述:    本机客户端共享内存环形缓冲区传输(memfd + eventfd)               */
+/* 创  建:    2026-10-19 changzehai                                          */
+/* 更  新:    无                                                             */
+/* Copyright 1998 - 2020 CZH. All Rights Reserved                            */
+/*****************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifndef __SHM_RING_H_
+#define __SHM_RING_H_
+
+
+/*-----------------------------------*/
+/* 宏定义                            */
+/*-----------------------------------*/
+#define SHM_RING_SIZE       (64 * 1024) /* 单个环形缓冲区数据区大小，必须为2的幂 */
+
+
+/*-----------------------------------*/
+/* 数据结构定义                       */
+/*-----------------------------------*/
+/* 共享内存中的单生产者单消费者环形缓冲区 */
+typedef struct _shm_ring_t_
+{
+    uint32_t head;          /* 消费者读位置，只由消费者更新 */
+    char pad1[60];
+    uint32_t tail;          /* 生产者写位置，只由生产者更新 */
+    char pad2[60];
+    uint32_t data_waiting;  /* 消费者等待数据时置1 */
+    uint32_t space_waiting; /* 生产者等待空间时置1 */
+    uint32_t size;          /* 数据区大小，仅供参考，索引计算只用SHM_RING_SIZE */
+    char pad3[52];
+    char data[SHM_RING_SIZE];
+} shm_ring_t;
+
+/* 一个共享内存连接: 请求环(客户端->服务器) + 应答环(服务器->客户端) */
+typedef struct _shm_ring_conn_t_
+{
+    int ctrl_sock;      /* 传递文件描述符的unix域套接字，同时用于检测对端退出 */
+    int mem_fd;         /* memfd */
+    void *base;         /* 共享内存映射地址 */
+    shm_ring_t *rx;     /* 本端读取的环 */
+    shm_ring_t *tx;     /* 本端写入的环 */
+    int rx_data_efd;    /* rx有数据门铃 */
+    int rx_space_efd;   /* rx有空间门铃 */
+    int tx_data_efd;    /* tx有数据门铃 */
+    int tx_space_efd;   /* tx有空间门铃 */
+} shm_ring_conn_t;
+
+
+/*-----------------------------------*/
+/* API函数声明                       */
+/*-----------------------------------*/
+extern int shm_ring_server_accept(int ctrl_sock, shm_ring_conn_t **conn);
+extern int shm_ring_client_attach(int ctrl_sock, shm_ring_conn_t **conn);
+extern ssize_t shm_ring_read(shm_ring_conn_t *conn, void *buf, size_t len);
+extern ssize_t shm_ring_write(shm_ring_conn_t *conn, const void *buf, size_t len);
+extern void shm_ring_close(shm_ring_conn_t *conn);
+#endif
@@ -2,64 +2,266 @@
 /* 文件名:    simple_client.c                                                */
 /* 描  述:    简单客户端实现                                                  */
 /* 创  建:    2020-04-12 changzehai                                          */
-/* 更  新:    无                                                             */
+/* 更  新:    2026-10-19 changzehai 增加unix域套接字和共享内存环传输           */
+/*            2026-10-19 changzehai 增加分帧协议和请求流水线                   */
 /* Copyright 1998 - 2020 CZH. All Rights Reserved                            */
 /*****************************************************************************/
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdlib.h>
+#include "shm_ring.h"
 
 
+/*-----------------------------------*/
+/* 宏定义                            */
+/*-----------------------------------*/
+#define FRAME_HDR_LEN       4       /* 帧头: 4字节网络序负载长度 */
+#define FRAME_BUF_LEN       4096
+
+/*-----------------------------------*/
+/* 变量定义                          */
+/*-----------------------------------*/
+static shm_ring_conn_t *gs_ring = NULL;
+
+/*****************************************************************************
+ * 函  数:    client_send
+ * 功  能:    向服务器发送数据
+ * 输  入:    sockfd: 套接字
+ *            buf:    待发送数据
+ *            len:    数据长度
+ * 输  出:    无
+ * 返回值:    返回发送的字节数，出错返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static ssize_t client_send(int sockfd, const void *buf, size_t len)
+{
+	if (NULL != gs_ring)
+	{
+		return shm_ring_write(gs_ring, buf, len);
+	}
+
+	return write(sockfd, buf, len);
+}
+
+/*****************************************************************************
+ * 函  数:    client_recv
+ * 功  能:    接收服务器数据
+ * 输  入:    sockfd: 套接字
+ *            buf:    接收缓冲区
+ *            len:    缓冲区长度
+ * 输  出:    无
+ * 返回值:    返回接收的字节数，服务器退出返回0
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static ssize_t client_recv(int sockfd, void *buf, size_t len)
+{
+	if (NULL != gs_ring)
+	{
+		return shm_ring_read(gs_ring, buf, len);
+	}
+
+	return read(sockfd, buf, len);
+}
+
+/*****************************************************************************
+ * 函  数:    client_framed_loop
+ * 功  能:    分帧协议收发: 每轮把depth个请求帧合并为一次写发出，
+ *            再读取直到收齐depth个应答帧
+ * 输  入:    sockfd: 套接字
+ *            depth:  流水线深度
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void client_framed_loop(int sockfd, int depth)
+{
+	char out[FRAME_BUF_LEN];
+	char in[FRAME_BUF_LEN];
+	char payload[32];
+	size_t out_len = 0;
+	size_t in_len = 0;
+	size_t pos = 0;
+	uint32_t frame_len = 0;
+	uint32_t net_len = 0;
+	ssize_t nbytes = 0;
+	int cnt = 0;
+	int i = 0;
+	int replies = 0;
+
+	while (1)
+	{
+		/* 组装depth个请求帧 */
+		out_len = 0;
+		for (i = 0; i < depth; i++)
+		{
+			frame_len = sprintf(payload, "%d", cnt++);
+			net_len = htonl(frame_len);
+			memcpy(out + out_len, &net_len, FRAME_HDR_LEN);
+			memcpy(out + out_len + FRAME_HDR_LEN, payload, frame_len);
+			out_len += FRAME_HDR_LEN + frame_len;
+		}
+		if (-1 == client_send(sockfd, out, out_len))
+		{
+			break;
+		}
+		printf("客户端发送: %d个请求\n", depth);
+
+		/* 读取直到收齐depth个应答 */
+		replies = 0;
+		while (replies < depth)
+		{
+			nbytes = client_recv(sockfd, in + in_len, sizeof(in) - in_len);
+			if (0 >= nbytes)
+			{
+				return;
+			}
+			in_len += nbytes;
+
+			pos = 0;
+			while (in_len - pos >= FRAME_HDR_LEN)
+			{
+				memcpy(&frame_len, in + pos, FRAME_HDR_LEN);
+				frame_len = ntohl(frame_len);
+				if (in_len - pos < FRAME_HDR_LEN + frame_len)
+				{
+					break;
+				}
+				printf("服务器回复: %.*s\n", (int)frame_len, in + pos + FRAME_HDR_LEN);
+				pos += FRAME_HDR_LEN + frame_len;
+				replies++;
+			}
+			in_len -= pos;
+			memmove(in, in + pos, in_len);
+		}
+		sleep(1);
+	}
+}
+
 /*****************************************************************************
  * 函  数:    main
  * 功  能:    主函数
  * 输  入:    无
  * 输  出:    无
- * 返回值:    无  
+ * 返回值:    无
  * 创  建:    2020-04-12 changzehai(DTT)
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 增加-u/-r选项连接本机服务器
+ *            2026-10-19 changzehai 增加-f/-p选项使用分帧协议和流水线
  ****************************************************************************/
-int main()
+int main(int argc, char *argv[])
 {
 	int sockfd;
 	int len;
 	struct sockaddr_in address;
+	struct sockaddr_un unix_address;
 	int result;
 	int cnt = 0;
+	int opt = 0;
+	int use_ring = 0;
+	int framed = 0;
+	int depth = 8;
+	const char *unix_path = NULL;
+	ssize_t nbytes = 0;
 	char buf[128] = {0};
-	
-    /* 创建客户端socket */
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
-	address.sin_family = AF_INET;
-	address.sin_addr.s_addr = inet_addr("127.0.0.1");
-	address.sin_port = htons(8000);
-	len = sizeof(address);
-
-    /* 连接客户端 */
-	result = connect(sockfd, (struct sockaddr *)&address, len);
+
+	while (-1 != (opt = getopt(argc, argv, "u:r:fp:")))
+	{
+		switch (opt)
+		{
+			case 'r':
+				use_ring = 1;
+				/* fall through */
+			case 'u':
+				unix_path = optarg;
+				break;
+			case 'f':
+				framed = 1;
+				break;
+			case 'p':
+				depth = atoi(optarg);
+				break;
+			default:
+				printf("用法: %s [-u unix_path | -r unix_path] [-f [-p depth]]\n", argv[0]);
+				return -1;
+		}
+	}
+
+	if (NULL != unix_path)
+	{
+		/* 创建unix域套接字 */
+		sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+		memset(&unix_address, 0x00, sizeof(unix_address));
+		unix_address.sun_family = AF_UNIX;
+		strncpy(unix_address.sun_path, unix_path, sizeof(unix_address.sun_path) - 1);
+		result = connect(sockfd, (struct sockaddr *)&unix_address, sizeof(unix_address));
+	}
+	else
+	{
+		/* 创建客户端socket */
+		sockfd = socket(AF_INET, SOCK_STREAM, 0);
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = inet_addr("127.0.0.1");
+		address.sin_port = htons(8000);
+		len = sizeof(address);
+
+		/* 连接客户端 */
+		result = connect(sockfd, (struct sockaddr *)&address, len);
+	}
 	if (result == -1)
 	{
 	    perror("oops: client1");
 	    return -1;
 	}
-	
-	while (1)
+
+	/* 共享内存环方式: 接收服务器传来的环，之后收发不再经过套接字 */
+	if ((1 == use_ring) && (-1 == shm_ring_client_attach(sockfd, &gs_ring)))
+	{
+		close(sockfd);
+		return -1;
+	}
+
+	/* 每轮请求最多占用FRAME_BUF_LEN */
+	if ((depth < 1) || (depth > 64))
+	{
+		depth = 8;
+	}
+
+	if (1 == framed)
+	{
+		client_framed_loop(sockfd, depth);
+	}
+
+	while (0 == framed)
 	{
 		sprintf(buf, "%d\n", cnt++);
-		write(sockfd, buf, strlen(buf));
+		client_send(sockfd, buf, strlen(buf));
 		printf("客户端发送: %s\n", buf);
-		if (0 >= read(sockfd, buf, sizeof(buf)))
+		nbytes = client_recv(sockfd, buf, sizeof(buf) - 1);
+		if (0 >= nbytes)
         {
             break;
         }
+		buf[nbytes] = '\0';
 		printf("服务器回复: %s\n", buf);
 		sleep(1);
 	}
-	
-	close(sockfd);
+
+	if (NULL != gs_ring)
+	{
+		/* 同时关闭套接字 */
+		shm_ring_close(gs_ring);
+	}
+	else
+	{
+		close(sockfd);
+	}
 	return 0;
 }
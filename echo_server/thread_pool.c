@@ -18,6 +18,7 @@
 #include <pthread.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <time.h>
 #include "thread_pool.h"
 
 
@@ -31,6 +32,11 @@ typedef struct _task_t_
 {
     void *(*task_process)(void *arg);
     void *arg;
+    void (*task_drop)(void *arg);       /* 任务被取消时释放arg，可为NULL */
+    thread_cancel_token_t *token;       /* 取消令牌，可为NULL */
+    const char *label;                  /* 跟踪用任务名，可为NULL */
+    unsigned long id;                   /* 跟踪用任务ID，未开启跟踪时为0 */
+    thread_task_group_t *group;         /* 所属任务组，可为NULL */
     struct _task_t_ *next;
 } task_t;
 
@@ -50,13 +56,80 @@ typedef struct _thread_pool_t_
     task_queue_t *task_queue;
     pthread_mutex_t task_queue_lock;
     pthread_cond_t task_queue_ready;
+    pthread_cond_t task_group_ready;    /* 任务组子任务入队或任务组完成时广播，唤醒thread_pool_group_wait */
 
 } thread_pool_t;
 
+/* 串行执行器数据结构 */
+struct _thread_strand_t_
+{
+    pthread_mutex_t lock;       /* 只保护queue和scheduled，执行任务时不持有 */
+    task_queue_t queue;         /* 待执行任务 */
+    int scheduled;              /* 1: 已投递到线程池或正在某个工作线程上执行 */
+};
+
+/* 任务组数据结构 */
+struct _thread_task_group_t_
+{
+    int pending;                /* 未完成的子任务数，由task_queue_lock保护 */
+    struct _thread_task_group_t_ *parent;   /* 创建本组的任务所属的任务组，顶层为NULL */
+};
+
+/* 取消令牌数据结构 */
+struct _thread_cancel_token_t_
+{
+    int cancelled;              /* 1: 已取消 */
+    int ref_count;              /* 引用计数，创建者和每个附加了该令牌的任务各持有一个 */
+    int has_deadline;           /* 1: 设置了超时 */
+    struct timespec deadline;   /* 超时时刻(CLOCK_MONOTONIC) */
+};
+
+/* 跟踪事件类型 */
+typedef enum _trace_type_t_
+{
+    TRACE_SUBMIT = 0,   /* 任务入队 */
+    TRACE_DEQUEUE,      /* 任务出队 */
+    TRACE_START,        /* 开始执行 */
+    TRACE_FINISH,       /* 执行完毕 */
+    TRACE_DROP          /* 已取消，丢弃 */
+} trace_type_t;
+
+/* 跟踪事件 */
+typedef struct _trace_event_t_
+{
+    trace_type_t type;
+    long long ts_ns;        /* CLOCK_MONOTONIC时间戳 */
+    unsigned long task_id;
+    const char *label;
+} trace_event_t;
+
+/* 每个线程一个跟踪缓冲区，只由所属线程写入，无需加锁 */
+typedef struct _trace_buf_t_
+{
+    int tid;                    /* 工作线程为编号，其他线程从1000开始编号 */
+    int is_worker;
+    int capacity;
+    int count;                  /* 已写入事件数，写满后丢弃新事件 */
+    int dropped;
+    trace_event_t *events;
+    struct _trace_buf_t_ *next;
+} trace_buf_t;
+
 /*-----------------------------------*/
 /* 变量定义                          */
 /*-----------------------------------*/
 static thread_pool_t  *gs_thread_pool = NULL;
+static __thread thread_cancel_token_t *gs_current_token = NULL; /* 当前线程正在执行的任务的令牌 */
+static __thread thread_task_group_t *gs_current_group = NULL;   /* 当前线程正在执行的任务所属的任务组 */
+static __thread int gs_worker_id = -1;                          /* 当前线程的工作线程编号，非工作线程为-1 */
+
+static int gs_trace_enabled = 0;
+static int gs_trace_capacity = THREAD_TRACE_EVENTS;
+static unsigned long gs_trace_task_id = 0;
+static int gs_trace_next_tid = 1000;
+static trace_buf_t *gs_trace_bufs = NULL;                       /* 所有线程的跟踪缓冲区链表 */
+static pthread_mutex_t gs_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread trace_buf_t *gs_trace_buf = NULL;               /* 当前线程的跟踪缓冲区 */
 
 /*-----------------------------------*/
 /* 内部函数声明                       */ 
@@ -65,9 +138,19 @@ static int thread_pool_task_queue_init(task_queue_t **task_queue);
 static int thread_pool_task_queue_is_empty(task_queue_t *task_queue);
 static void thread_pool_task_queue_push(task_queue_t *task_queue, task_t *task);
 static task_t *thread_pool_task_queue_pop(task_queue_t *task_queue);
+static task_t *thread_pool_task_queue_pop_group(task_queue_t *task_queue, thread_task_group_t *group);
+static int thread_pool_task_queue_remove(task_queue_t *task_queue, task_t *task);
 static void thread_pool_task_queue_destory(task_queue_t *task_queue);
 static void *thread_worker_routine(void *arg);
 static int thread_pool_create_worker(pthread_t **threads, int max_thread_num);
+static void *thread_pool_strand_routine(void *arg);
+static void thread_pool_task_run(task_t *task);
+static int thread_pool_task_submit(void *(*task_process) (void *arg), void *arg,
+                                   void (*task_drop) (void *arg),
+                                   thread_cancel_token_t *token, const char *label,
+                                   thread_task_group_t *group);
+static void thread_pool_trace_record(trace_type_t type, task_t *task);
+static void thread_pool_trace_write_string(FILE *fp, const char *str);
 
 /*****************************************************************************
  * 函  数:    thread_pool_task_queue_init
@@ -159,7 +242,7 @@ static void thread_pool_task_queue_push(task_queue_t *task_queue, task_t *task)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 任务参数不再假定为客户端套接字
  ****************************************************************************/
 static task_t *thread_pool_task_queue_pop(task_queue_t *task_queue)
 {
@@ -177,10 +260,99 @@ static task_t *thread_pool_task_queue_pop(task_queue_t *task_queue)
         }
     }
 
-    printf("取出客户端%d\n", (*(int *)task->arg - 3));
     return task;
 }
 
+/*****************************************************************************
+ * 函  数:    thread_pool_task_queue_pop_group
+ * 功  能:    从任务队列中取出属于指定任务组或其后代任务组的第一个任务
+ * 输  入:    task_queue: 任务队列
+ *            group:      任务组
+ * 输  出:    无
+ * 返回值:    找到返回任务，否则返回NULL
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 包括后代任务组的任务
+ ****************************************************************************/
+static task_t *thread_pool_task_queue_pop_group(task_queue_t *task_queue, thread_task_group_t *group)
+{
+    task_t *prev = NULL;
+    task_t *task = NULL;
+    thread_task_group_t *ancestor = NULL;
+
+    for (task = task_queue->head; NULL != task; prev = task, task = task->next)
+    {
+        /* 后代任务组未完成时祖先任务组都在等待，沿parent链访问是安全的 */
+        for (ancestor = task->group; (NULL != ancestor) && (group != ancestor); ancestor = ancestor->parent)
+        {
+        }
+        if (NULL == ancestor)
+        {
+            continue;
+        }
+
+        /* 从链表中摘除 */
+        if (NULL == prev)
+        {
+            task_queue->head = task->next;
+        }
+        else
+        {
+            prev->next = task->next;
+        }
+        if (task_queue->tail == task)
+        {
+            task_queue->tail = prev;
+        }
+        task->next = NULL;
+
+        return task;
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_task_queue_remove
+ * 功  能:    从任务队列中摘除指定任务
+ * 输  入:    task_queue: 任务队列
+ *            task:       要摘除的任务
+ * 输  出:    无
+ * 返回值:    找到并摘除返回0，任务不在队列中返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static int thread_pool_task_queue_remove(task_queue_t *task_queue, task_t *task)
+{
+    task_t *prev = NULL;
+    task_t *cur = NULL;
+
+    for (cur = task_queue->head; NULL != cur; prev = cur, cur = cur->next)
+    {
+        if (task != cur)
+        {
+            continue;
+        }
+
+        if (NULL == prev)
+        {
+            task_queue->head = cur->next;
+        }
+        else
+        {
+            prev->next = cur->next;
+        }
+        if (task_queue->tail == cur)
+        {
+            task_queue->tail = prev;
+        }
+        cur->next = NULL;
+
+        return 0;
+    }
+
+    return -1;
+}
+
 /*****************************************************************************
  * 函  数:    thread_pool_task_queue_destory
  * 功  能:    销毁任务队列
@@ -208,6 +380,58 @@ static void thread_pool_task_queue_destory(task_queue_t *task_queue)
 }
 
 
+/*****************************************************************************
+ * 函  数:    thread_pool_task_run
+ * 功  能:    执行一个任务并释放。任务的令牌已取消或超时则不执行，
+ *            只调用task_drop释放参数
+ * 输  入:    task: 已出队的任务
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 记录跟踪事件
+ *            2026-10-19 changzehai 子任务完成时通知任务组
+ ****************************************************************************/
+static void thread_pool_task_run(task_t *task)
+{
+    thread_cancel_token_t *prev_token = gs_current_token;
+    thread_task_group_t *prev_group = gs_current_group;
+
+    if ((NULL != task->token) && (1 == thread_pool_cancel_token_is_cancelled(task->token)))
+    {
+        /* 已经失效的任务，直接丢弃 */
+        thread_pool_trace_record(TRACE_DROP, task);
+        if (NULL != task->task_drop)
+        {
+            task->task_drop(task->arg);
+        }
+    }
+    else
+    {
+        thread_pool_trace_record(TRACE_START, task);
+        gs_current_token = task->token;
+        gs_current_group = task->group;
+        task->task_process(task->arg);
+        gs_current_token = prev_token;
+        gs_current_group = prev_group;
+        thread_pool_trace_record(TRACE_FINISH, task);
+    }
+
+    /* 子任务完成，唤醒等待该任务组的线程 */
+    if (NULL != task->group)
+    {
+        pthread_mutex_lock(&(gs_thread_pool->task_queue_lock));
+        task->group->pending--;
+        if (0 == task->group->pending)
+        {
+            pthread_cond_broadcast(&(gs_thread_pool->task_group_ready));
+        }
+        pthread_mutex_unlock(&(gs_thread_pool->task_queue_lock));
+    }
+
+    thread_pool_cancel_token_release(task->token);
+    free(task);
+}
+
 /*****************************************************************************
  * 函  数:    thread_worker_routine
  * 功  能:    工作线程处理
@@ -215,11 +439,13 @@ static void thread_pool_task_queue_destory(task_queue_t *task_queue)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 任务参数不再假定为客户端套接字
+ *            2026-10-19 changzehai 参数为工作线程编号，记录出队跟踪事件
+ *            2026-10-19 changzehai 去掉每个任务的打印，改用任务跟踪观察
  ****************************************************************************/
 static void *thread_worker_routine(void *arg)
 {
-    (void)arg;
+    gs_worker_id = (int)(long)arg;
 
     while(1)
     {
@@ -242,12 +468,10 @@ static void *thread_worker_routine(void *arg)
         task_t *task = thread_pool_task_queue_pop(gs_thread_pool->task_queue);
         //thread_pool_task_queue_print();
         pthread_mutex_unlock (&(gs_thread_pool->task_queue_lock));
+        thread_pool_trace_record(TRACE_DEQUEUE, task);
 
-
-        printf ("由线程%lu 处理客户端%d\n\n", (long unsigned int )pthread_self(), (*(int *)task->arg - 3));
         /* 执行任务 */
-        task->task_process(task->arg);
-        free(task);
+        thread_pool_task_run(task);
         task = NULL;
 
     }
@@ -263,7 +487,7 @@ static void *thread_worker_routine(void *arg)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 把编号传给工作线程
  ****************************************************************************/
 static int thread_pool_create_worker(pthread_t **threads, int max_thread_num)
 {
@@ -277,7 +501,7 @@ static int thread_pool_create_worker(pthread_t **threads, int max_thread_num)
 
     for (i = 0; i < max_thread_num; i++)
     {
-        if (0 != pthread_create(&((*threads)[i]), NULL, thread_worker_routine, NULL))
+        if (0 != pthread_create(&((*threads)[i]), NULL, thread_worker_routine, (void *)(long)i))
         {
             return -1;
         }
@@ -295,7 +519,7 @@ static int thread_pool_create_worker(pthread_t **threads, int max_thread_num)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 初始化任务组条件变量
  ****************************************************************************/
 int thread_pool_init(int max_thread_num)
 {
@@ -322,6 +546,7 @@ int thread_pool_init(int max_thread_num)
 
     /* 初始化任务对列条件变量 */
     pthread_cond_init (&(gs_thread_pool->task_queue_ready), NULL);
+    pthread_cond_init (&(gs_thread_pool->task_group_ready), NULL);
 
     /* 创建工作线程 */
     if (-1 == thread_pool_create_worker(&gs_thread_pool->threads, gs_thread_pool->max_thread_num))
@@ -339,9 +564,68 @@ int thread_pool_init(int max_thread_num)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 改为调用thread_pool_add_task_cancelable
  ****************************************************************************/
 int thread_pool_add_task(void *(*task_process) (void *arg), void *arg)
+{
+    return thread_pool_add_task_cancelable(task_process, arg, NULL, NULL);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_add_task_cancelable
+ * 功  能:    向线程池中添加可取消的任务。令牌在任务出队时已取消或超时，
+ *            任务不执行，只调用task_drop释放arg；执行中的任务可通过
+ *            thread_pool_task_is_cancelled()轮询
+ * 输  入:    task_process: 任务处理函数
+ *            arg:          任务参数
+ *            task_drop:    任务被丢弃时调用，可为NULL
+ *            token:        取消令牌，可为NULL，任务持有一个引用
+ * 输  出:    无
+ * 返回值:    成功返回0，失败返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 改为调用thread_pool_task_submit
+ ****************************************************************************/
+int thread_pool_add_task_cancelable(void *(*task_process) (void *arg), void *arg,
+                                    void (*task_drop) (void *arg),
+                                    thread_cancel_token_t *token)
+{
+    return thread_pool_task_submit(task_process, arg, task_drop, token, NULL, NULL);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_add_task_labeled
+ * 功  能:    向线程池中添加带名字的任务，名字会出现在跟踪输出中
+ * 输  入:    task_process: 任务处理函数
+ *            arg:          任务参数
+ *            label:        任务名，须在跟踪输出前一直有效(通常为字符串常量)
+ * 输  出:    无
+ * 返回值:    成功返回0，失败返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_add_task_labeled(void *(*task_process) (void *arg), void *arg, const char *label)
+{
+    return thread_pool_task_submit(task_process, arg, NULL, NULL, label, NULL);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_task_submit
+ * 功  能:    构造任务并加入线程池任务队列
+ * 输  入:    task_process: 任务处理函数
+ *            arg:          任务参数
+ *            task_drop:    任务被丢弃时调用，可为NULL
+ *            token:        取消令牌，可为NULL
+ *            label:        跟踪用任务名，可为NULL
+ *            group:        所属任务组，可为NULL
+ * 输  出:    无
+ * 返回值:    成功返回0，失败返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 支持任务组
+ ****************************************************************************/
+static int thread_pool_task_submit(void *(*task_process) (void *arg), void *arg,
+                                   void (*task_drop) (void *arg),
+                                   thread_cancel_token_t *token, const char *label,
+                                   thread_task_group_t *group)
 {
     /* 构造一个新任务 */
     task_t *new_task = (task_t *)malloc(sizeof(task_t));
@@ -352,11 +636,25 @@ int thread_pool_add_task(void *(*task_process) (void *arg), void *arg)
 
     new_task->task_process = task_process;
     new_task->arg = arg;
+    new_task->task_drop = task_drop;
+    new_task->token = token;
+    new_task->label = label;
+    new_task->group = group;
     new_task->next = NULL;
 
+    if (NULL != token)
+    {
+        __atomic_add_fetch(&(token->ref_count), 1, __ATOMIC_RELAXED);
+    }
+
+    thread_pool_trace_record(TRACE_SUBMIT, new_task);
 
     /* 将新任务添加到任务队列中 */
     pthread_mutex_lock(&(gs_thread_pool->task_queue_lock));
+    if (NULL != group)
+    {
+        group->pending++;
+    }
     thread_pool_task_queue_push(gs_thread_pool->task_queue, new_task);
     //thread_pool_task_queue_print();
     pthread_mutex_unlock(&(gs_thread_pool->task_queue_lock));
@@ -364,6 +662,12 @@ int thread_pool_add_task(void *(*task_process) (void *arg), void *arg)
     /* 通知阻塞的空闲工作线程有新任务到了 */
     pthread_cond_signal (&(gs_thread_pool->task_queue_ready));
 
+    /* 子任务入队，等待中的祖先任务组可以帮忙执行 */
+    if (NULL != group)
+    {
+        pthread_cond_broadcast(&(gs_thread_pool->task_group_ready));
+    }
+
     return 0;
 }
 
@@ -374,7 +678,7 @@ int thread_pool_add_task(void *(*task_process) (void *arg), void *arg)
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 销毁任务组条件变量
  ****************************************************************************/
 int thread_pool_destory()
 {
@@ -406,6 +710,7 @@ int thread_pool_destory()
 
     /* 销毁任务队列条件变量 */
     pthread_cond_destroy(&(gs_thread_pool->task_queue_ready));
+    pthread_cond_destroy(&(gs_thread_pool->task_group_ready));
 
     free(gs_thread_pool);
     gs_thread_pool = NULL;
@@ -443,7 +748,7 @@ void thread_pool_worker_id_print()
  * 输  出:    无
  * 返回值:    无  
  * 创  建:    2020-04-12 changzehai
- * 更  新:    无
+ * 更  新:    2026-10-19 changzehai 任务参数不再假定为客户端套接字
  ****************************************************************************/
 void thread_pool_task_queue_print()
 {
@@ -454,9 +759,709 @@ void thread_pool_task_queue_print()
     while(task != NULL)
     {
 
-       printf("客户端%d\n", (*(int *)(task->arg) - 3));
+       printf("任务%p\n", task->arg);
         task = task->next;
     }
 
     printf("\n");
 }
+
+/*****************************************************************************
+ * 函  数:    thread_pool_strand_routine
+ * 功  能:    strand在工作线程上的执行体: 按顺序执行最多THREAD_STRAND_BATCH个
+ *            任务，仍有任务则重新投递到线程池末尾，让其他strand和任务有机会执行
+ * 输  入:    arg: strand
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void *thread_pool_strand_routine(void *arg)
+{
+    thread_strand_t *strand = (thread_strand_t *)arg;
+    task_t *task = NULL;
+    int i = 0;
+
+    while (1)
+    {
+        for (i = 0; i < THREAD_STRAND_BATCH; i++)
+        {
+            pthread_mutex_lock(&(strand->lock));
+            if (1 == thread_pool_task_queue_is_empty(&(strand->queue)))
+            {
+                /* 没有任务了，下次投递时重新调度 */
+                strand->scheduled = 0;
+                pthread_mutex_unlock(&(strand->lock));
+                return NULL;
+            }
+            task = thread_pool_task_queue_pop(&(strand->queue));
+            pthread_mutex_unlock(&(strand->lock));
+            thread_pool_trace_record(TRACE_DEQUEUE, task);
+
+            /* 执行任务，不持有任何锁 */
+            thread_pool_task_run(task);
+            task = NULL;
+        }
+
+        pthread_mutex_lock(&(strand->lock));
+        if (1 == thread_pool_task_queue_is_empty(&(strand->queue)))
+        {
+            strand->scheduled = 0;
+            pthread_mutex_unlock(&(strand->lock));
+            return NULL;
+        }
+        pthread_mutex_unlock(&(strand->lock));
+
+        /* 仍有任务，保持scheduled重新排队；投递失败则在本线程继续执行 */
+        if (0 == thread_pool_add_task_labeled(thread_pool_strand_routine, strand, "strand"))
+        {
+            return NULL;
+        }
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_strand_create
+ * 功  能:    创建串行执行器
+ * 输  入:    无
+ * 输  出:    无
+ * 返回值:    成功返回strand，失败返回NULL
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+thread_strand_t *thread_pool_strand_create()
+{
+    thread_strand_t *strand = NULL;
+
+    strand = (thread_strand_t *)malloc(sizeof(thread_strand_t));
+    if (NULL == strand)
+    {
+        printf("thread_pool_strand_create() malloc failed\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&(strand->lock), NULL);
+    strand->queue.head = NULL;
+    strand->queue.tail = NULL;
+    strand->scheduled = 0;
+
+    return strand;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_strand_post
+ * 功  能:    向strand投递任务。同一strand的任务按投递顺序逐个执行，
+ *            不同strand的任务在线程池中并行执行。strand只在有任务时
+ *            才占用线程池队列中的一个位置
+ * 输  入:    strand:       串行执行器
+ *            task_process: 任务处理函数
+ *            arg:          任务参数
+ * 输  出:    无
+ * 返回值:    成功返回0；失败返回-1，任务未被接受，不会执行，arg仍归调用者
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 调度失败时撤回任务
+ *            2026-10-19 changzehai 改为调用thread_pool_strand_post_cancelable
+ ****************************************************************************/
+int thread_pool_strand_post(thread_strand_t *strand, void *(*task_process) (void *arg), void *arg)
+{
+    return thread_pool_strand_post_cancelable(strand, task_process, arg, NULL, NULL);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_strand_post_cancelable
+ * 功  能:    向strand投递可取消的任务。顺序语义同thread_pool_strand_post；
+ *            轮到该任务时令牌已取消或超时，任务不执行，只调用task_drop
+ *            释放arg，后续任务照常按顺序执行
+ * 输  入:    strand:       串行执行器
+ *            task_process: 任务处理函数
+ *            arg:          任务参数
+ *            task_drop:    任务被丢弃时调用，可为NULL
+ *            token:        取消令牌，可为NULL，任务持有一个引用
+ * 输  出:    无
+ * 返回值:    成功返回0；失败返回-1，任务未被接受，不会执行，arg仍归调用者
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 调度失败时在本线程执行其他已接受的任务
+ ****************************************************************************/
+int thread_pool_strand_post_cancelable(thread_strand_t *strand,
+                                       void *(*task_process) (void *arg), void *arg,
+                                       void (*task_drop) (void *arg),
+                                       thread_cancel_token_t *token)
+{
+    task_t *new_task = NULL;
+    int need_schedule = 0;
+
+    if (NULL == strand)
+    {
+        printf("thread_pool_strand_post_cancelable()参数有误,strand为NULL\n");
+        return -1;
+    }
+
+    /* 构造一个新任务 */
+    new_task = (task_t *)malloc(sizeof(task_t));
+    if (NULL == new_task)
+    {
+        return -1;
+    }
+
+    new_task->task_process = task_process;
+    new_task->arg = arg;
+    new_task->task_drop = task_drop;
+    new_task->token = token;
+    new_task->label = "strand item";
+    new_task->group = NULL;
+    new_task->next = NULL;
+    thread_pool_trace_record(TRACE_SUBMIT, new_task);
+
+    if (NULL != token)
+    {
+        __atomic_add_fetch(&(token->ref_count), 1, __ATOMIC_RELAXED);
+    }
+
+    /* 加入strand队列，strand空闲时由本次投递负责调度 */
+    pthread_mutex_lock(&(strand->lock));
+    thread_pool_task_queue_push(&(strand->queue), new_task);
+    if (0 == strand->scheduled)
+    {
+        strand->scheduled = 1;
+        need_schedule = 1;
+    }
+    pthread_mutex_unlock(&(strand->lock));
+
+    if ((1 == need_schedule) &&
+        (-1 == thread_pool_add_task_labeled(thread_pool_strand_routine, strand, "strand")))
+    {
+        /* 调度失败，撤回本次投递的任务，调用者可以安全释放arg */
+        pthread_mutex_lock(&(strand->lock));
+        thread_pool_task_queue_remove(&(strand->queue), new_task);
+        need_schedule = (0 == thread_pool_task_queue_is_empty(&(strand->queue)));
+        if (0 == need_schedule)
+        {
+            strand->scheduled = 0;
+        }
+        pthread_mutex_unlock(&(strand->lock));
+        thread_pool_cancel_token_release(new_task->token);
+        free(new_task);
+
+        /* 期间其他线程投递成功的任务已返回成功，scheduled保持为1由本线程负责:
+           再调度失败则在本线程按顺序执行完，不能等待下一次投递 */
+        if ((1 == need_schedule) &&
+            (-1 == thread_pool_add_task_labeled(thread_pool_strand_routine, strand, "strand")))
+        {
+            thread_pool_strand_routine(strand);
+        }
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_strand_destory
+ * 功  能:    销毁串行执行器
+ * 输  入:    strand: 串行执行器
+ * 输  出:    无
+ * 返回值:    成功返回0，strand仍有任务未执行完返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_strand_destory(thread_strand_t *strand)
+{
+    if (NULL == strand)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&(strand->lock));
+    if ((1 == strand->scheduled) ||
+        (0 == thread_pool_task_queue_is_empty(&(strand->queue))))
+    {
+        pthread_mutex_unlock(&(strand->lock));
+        return -1;
+    }
+    pthread_mutex_unlock(&(strand->lock));
+
+    pthread_mutex_destroy(&(strand->lock));
+    free(strand);
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_cancel_token_create
+ * 功  能:    创建取消令牌
+ * 输  入:    timeout_ms: 超时时间(毫秒)，从创建时开始计时，超时后视为已取消；
+ *                        <= 0表示不超时
+ * 输  出:    无
+ * 返回值:    成功返回令牌，失败返回NULL。调用者持有一个引用，
+ *            用完后调用thread_pool_cancel_token_release释放
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+thread_cancel_token_t *thread_pool_cancel_token_create(int timeout_ms)
+{
+    thread_cancel_token_t *token = NULL;
+
+    token = (thread_cancel_token_t *)malloc(sizeof(thread_cancel_token_t));
+    if (NULL == token)
+    {
+        printf("thread_pool_cancel_token_create() malloc failed\n");
+        return NULL;
+    }
+
+    token->cancelled = 0;
+    token->ref_count = 1;
+    token->has_deadline = 0;
+
+    if (timeout_ms > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &(token->deadline));
+        token->deadline.tv_sec += timeout_ms / 1000;
+        token->deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (token->deadline.tv_nsec >= 1000000000L)
+        {
+            token->deadline.tv_sec += 1;
+            token->deadline.tv_nsec -= 1000000000L;
+        }
+        token->has_deadline = 1;
+    }
+
+    return token;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_cancel_token_cancel
+ * 功  能:    取消令牌，附加了该令牌的排队中任务将被丢弃
+ * 输  入:    token: 取消令牌
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void thread_pool_cancel_token_cancel(thread_cancel_token_t *token)
+{
+    if (NULL != token)
+    {
+        __atomic_store_n(&(token->cancelled), 1, __ATOMIC_RELEASE);
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_cancel_token_is_cancelled
+ * 功  能:    检查令牌是否已取消或已超时
+ * 输  入:    token: 取消令牌
+ * 输  出:    无
+ * 返回值:    已取消返回1，否则返回0
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_cancel_token_is_cancelled(thread_cancel_token_t *token)
+{
+    struct timespec now;
+
+    if (NULL == token)
+    {
+        return 0;
+    }
+
+    if (1 == __atomic_load_n(&(token->cancelled), __ATOMIC_ACQUIRE))
+    {
+        return 1;
+    }
+
+    if (1 == token->has_deadline)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec > token->deadline.tv_sec) ||
+            ((now.tv_sec == token->deadline.tv_sec) && (now.tv_nsec >= token->deadline.tv_nsec)))
+        {
+            /* 超时自动取消 */
+            __atomic_store_n(&(token->cancelled), 1, __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_cancel_token_release
+ * 功  能:    释放令牌的一个引用，最后一个引用释放时销毁令牌
+ * 输  入:    token: 取消令牌，可为NULL
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void thread_pool_cancel_token_release(thread_cancel_token_t *token)
+{
+    if (NULL == token)
+    {
+        return;
+    }
+
+    if (0 == __atomic_sub_fetch(&(token->ref_count), 1, __ATOMIC_ACQ_REL))
+    {
+        free(token);
+    }
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_task_is_cancelled
+ * 功  能:    在任务处理函数中调用，检查当前任务是否已被取消或已超时，
+ *            长时间运行的任务应定期检查并尽早返回
+ * 输  入:    无
+ * 输  出:    无
+ * 返回值:    已取消返回1，否则返回0
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_task_is_cancelled()
+{
+    return thread_pool_cancel_token_is_cancelled(gs_current_token);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_trace_record
+ * 功  能:    记录一个任务生命周期事件到当前线程的跟踪缓冲区
+ * 输  入:    type: 事件类型
+ *            task: 任务
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void thread_pool_trace_record(trace_type_t type, task_t *task)
+{
+    trace_buf_t *buf = gs_trace_buf;
+    trace_event_t *event = NULL;
+    struct timespec now;
+
+    if (TRACE_SUBMIT == type)
+    {
+        /* 未开启跟踪时也要清零，避免出队时用到未初始化的ID */
+        task->id = 0;
+    }
+
+    if (0 == __atomic_load_n(&gs_trace_enabled, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    if (TRACE_SUBMIT == type)
+    {
+        task->id = __atomic_add_fetch(&gs_trace_task_id, 1, __ATOMIC_RELAXED);
+    }
+
+    /* 本线程第一次记录时创建缓冲区 */
+    if (NULL == buf)
+    {
+        buf = (trace_buf_t *)malloc(sizeof(trace_buf_t));
+        if (NULL == buf)
+        {
+            return;
+        }
+        buf->capacity = __atomic_load_n(&gs_trace_capacity, __ATOMIC_RELAXED);
+        buf->events = (trace_event_t *)malloc(buf->capacity * sizeof(trace_event_t));
+        if (NULL == buf->events)
+        {
+            free(buf);
+            return;
+        }
+        buf->count = 0;
+        buf->dropped = 0;
+        buf->is_worker = (-1 != gs_worker_id);
+
+        pthread_mutex_lock(&gs_trace_lock);
+        buf->tid = (1 == buf->is_worker) ? gs_worker_id : gs_trace_next_tid++;
+        buf->next = gs_trace_bufs;
+        gs_trace_bufs = buf;
+        pthread_mutex_unlock(&gs_trace_lock);
+
+        gs_trace_buf = buf;
+    }
+
+    if (buf->count >= buf->capacity)
+    {
+        buf->dropped++;
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    event = &(buf->events[buf->count]);
+    event->type = type;
+    event->ts_ns = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+    event->task_id = task->id;
+    event->label = (NULL != task->label) ? task->label : "task";
+
+    /* 事件写完后再发布，thread_pool_trace_dump只读取已发布的事件 */
+    __atomic_store_n(&(buf->count), buf->count + 1, __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_trace_enable
+ * 功  能:    开启任务跟踪，记录入队/出队/开始/结束事件
+ * 输  入:    events_per_thread: 每个线程最多记录的事件数，<= 0使用默认值
+ *                               THREAD_TRACE_EVENTS，只对之后新建的缓冲区生效
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void thread_pool_trace_enable(int events_per_thread)
+{
+    if (events_per_thread <= 0)
+    {
+        events_per_thread = THREAD_TRACE_EVENTS;
+    }
+
+    __atomic_store_n(&gs_trace_capacity, events_per_thread, __ATOMIC_RELAXED);
+    __atomic_store_n(&gs_trace_enabled, 1, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_trace_disable
+ * 功  能:    停止记录跟踪事件，已记录的事件保留，仍可输出
+ * 输  入:    无
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+void thread_pool_trace_disable()
+{
+    __atomic_store_n(&gs_trace_enabled, 0, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_trace_write_string
+ * 功  能:    以JSON字符串格式输出
+ * 输  入:    fp:  输出文件
+ *            str: 字符串
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+static void thread_pool_trace_write_string(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; '\0' != *str; str++)
+    {
+        if (('"' == *str) || ('\\' == *str))
+        {
+            fprintf(fp, "\\%c", *str);
+        }
+        else if ((unsigned char)*str < 0x20)
+        {
+            fprintf(fp, "\\u%04x", (unsigned char)*str);
+        }
+        else
+        {
+            fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_trace_dump
+ * 功  能:    把已记录的跟踪事件以Chrome trace-event JSON格式写入文件，
+ *            可用chrome://tracing或ui.perfetto.dev打开。排队等待显示为
+ *            "queue"类的异步区间，执行显示为所在线程上的区间
+ * 输  入:    path: 输出文件路径
+ * 输  出:    无
+ * 返回值:    成功返回0，失败返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_trace_dump(const char *path)
+{
+    FILE *fp = NULL;
+    trace_buf_t *buf = NULL;
+    trace_event_t *event = NULL;
+    int count = 0;
+    int i = 0;
+    int first = 1;
+    int pid = (int)getpid();
+
+    fp = fopen(path, "w");
+    if (NULL == fp)
+    {
+        perror("thread_pool_trace_dump fopen");
+        return -1;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&gs_trace_lock);
+    for (buf = gs_trace_bufs; NULL != buf; buf = buf->next)
+    {
+        /* 线程名 */
+        fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s %d%s\"}}",
+                (1 == first) ? "" : ",\n", pid, buf->tid,
+                (1 == buf->is_worker) ? "worker" : "thread", buf->tid,
+                (0 != buf->dropped) ? " (buffer full)" : "");
+        first = 0;
+
+        count = __atomic_load_n(&(buf->count), __ATOMIC_ACQUIRE);
+        for (i = 0; i < count; i++)
+        {
+            event = &(buf->events[i]);
+            fprintf(fp, ",\n{\"name\":");
+            thread_pool_trace_write_string(fp, event->label);
+
+            switch (event->type)
+            {
+                case TRACE_SUBMIT:
+                    fprintf(fp, ",\"cat\":\"queue\",\"ph\":\"b\",\"id\":%lu", event->task_id);
+                    break;
+                case TRACE_DEQUEUE:
+                    fprintf(fp, ",\"cat\":\"queue\",\"ph\":\"e\",\"id\":%lu", event->task_id);
+                    break;
+                case TRACE_START:
+                    fprintf(fp, ",\"cat\":\"task\",\"ph\":\"B\"");
+                    break;
+                case TRACE_FINISH:
+                    fprintf(fp, ",\"cat\":\"task\",\"ph\":\"E\"");
+                    break;
+                case TRACE_DROP:
+                    fprintf(fp, ",\"cat\":\"cancel\",\"ph\":\"i\",\"s\":\"t\"");
+                    break;
+            }
+
+            fprintf(fp, ",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,\"args\":{\"task_id\":%lu}}",
+                    event->ts_ns / 1000, event->ts_ns % 1000, pid, buf->tid, event->task_id);
+        }
+    }
+    pthread_mutex_unlock(&gs_trace_lock);
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    return 0;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_group_create
+ * 功  能:    创建任务组
+ * 输  入:    无
+ * 输  出:    无
+ * 返回值:    成功返回任务组，失败返回NULL
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+thread_task_group_t *thread_pool_group_create()
+{
+    thread_task_group_t *group = NULL;
+
+    group = (thread_task_group_t *)malloc(sizeof(thread_task_group_t));
+    if (NULL == group)
+    {
+        printf("thread_pool_group_create() malloc failed\n");
+        return NULL;
+    }
+
+    group->pending = 0;
+    group->parent = gs_current_group;
+
+    return group;
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_group_spawn
+ * 功  能:    向任务组添加子任务(fork)，子任务进入线程池任务队列
+ * 输  入:    group:        任务组
+ *            task_process: 任务处理函数
+ *            arg:          任务参数
+ * 输  出:    无
+ * 返回值:    成功返回0，失败返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_group_spawn(thread_task_group_t *group, void *(*task_process) (void *arg), void *arg)
+{
+    if (NULL == group)
+    {
+        printf("thread_pool_group_spawn()参数有误,group为NULL\n");
+        return -1;
+    }
+
+    return thread_pool_task_submit(task_process, arg, NULL, NULL, "group child", group);
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_group_wait
+ * 功  能:    等待任务组的子任务全部完成(join)。等待期间当前线程从队列中
+ *            取本组及其后代任务组的任务执行，没有可执行的才睡眠，因此
+ *            在工作线程中递归fork/join不会占死工作线程，也不会死锁。
+ *            不执行无关任务，join的延迟不受其他长任务影响
+ * 输  入:    group: 任务组
+ * 输  出:    无
+ * 返回值:    无
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    2026-10-19 changzehai 只帮忙执行本组及后代任务组的任务
+ ****************************************************************************/
+void thread_pool_group_wait(thread_task_group_t *group)
+{
+    task_t *task = NULL;
+
+    if (NULL == group)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&(gs_thread_pool->task_queue_lock));
+    while (group->pending > 0)
+    {
+        /* 只取本组及后代任务组的任务 */
+        task = thread_pool_task_queue_pop_group(gs_thread_pool->task_queue, group);
+
+        if (NULL != task)
+        {
+            pthread_mutex_unlock(&(gs_thread_pool->task_queue_lock));
+            thread_pool_trace_record(TRACE_DEQUEUE, task);
+            thread_pool_task_run(task);
+            task = NULL;
+            pthread_mutex_lock(&(gs_thread_pool->task_queue_lock));
+            continue;
+        }
+
+        /* 子任务都在其他线程上执行，等待任务组完成或有新的子任务入队 */
+        pthread_cond_wait(&(gs_thread_pool->task_group_ready), &(gs_thread_pool->task_queue_lock));
+    }
+    pthread_mutex_unlock(&(gs_thread_pool->task_queue_lock));
+}
+
+/*****************************************************************************
+ * 函  数:    thread_pool_group_destory
+ * 功  能:    销毁任务组
+ * 输  入:    group: 任务组
+ * 输  出:    无
+ * 返回值:    成功返回0，仍有子任务未完成返回-1
+ * 创  建:    2026-10-19 changzehai
+ * 更  新:    无
+ ****************************************************************************/
+int thread_pool_group_destory(thread_task_group_t *group)
+{
+    int pending = 0;
+
+    if (NULL == group)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&(gs_thread_pool->task_queue_lock));
+    pending = group->pending;
+    pthread_mutex_unlock(&(gs_thread_pool->task_queue_lock));
+
+    if (0 != pending)
+    {
+        return -1;
+    }
+
+    free(group);
+
+    return 0;
+}
@@ -10,6 +10,23 @@
 #ifndef __THREAD_POOL_H_
 #define __THREAD_POOL_H_
 
+/*-----------------------------------*/
+/* 宏定义                            */
+/*-----------------------------------*/
+#define THREAD_STRAND_BATCH     8   /* strand每次被调度最多连续执行的任务数 */
+#define THREAD_TRACE_EVENTS     (64 * 1024) /* 跟踪模式下每个线程默认最多记录的事件数 */
+
+/*-----------------------------------*/
+/* 数据结构定义                       */
+/*-----------------------------------*/
+/* 串行执行器: 投递到同一strand的任务按投递顺序逐个执行 */
+typedef struct _thread_strand_t_ thread_strand_t;
+
+/* 取消令牌: 提交任务时附加，取消或超时后排队中的任务被丢弃，执行中的任务可轮询 */
+typedef struct _thread_cancel_token_t_ thread_cancel_token_t;
+
+/* 任务组(fork/join): 等待子任务时当前线程帮助执行本组及后代的任务，不阻塞工作线程 */
+typedef struct _thread_task_group_t_ thread_task_group_t;
 
 /*-----------------------------------*/
 /* API函数声明                       */
@@ -19,4 +36,27 @@ extern int thread_pool_add_task(void *(*task_process) (void *arg), void *arg);
 extern int thread_pool_destory();
 extern void thread_pool_worker_id_print();
 extern void thread_pool_task_queue_print();
+extern thread_strand_t *thread_pool_strand_create();
+extern int thread_pool_strand_post(thread_strand_t *strand, void *(*task_process) (void *arg), void *arg);
+extern int thread_pool_strand_destory(thread_strand_t *strand);
+extern thread_cancel_token_t *thread_pool_cancel_token_create(int timeout_ms);
+extern void thread_pool_cancel_token_cancel(thread_cancel_token_t *token);
+extern int thread_pool_cancel_token_is_cancelled(thread_cancel_token_t *token);
+extern void thread_pool_cancel_token_release(thread_cancel_token_t *token);
+extern int thread_pool_add_task_cancelable(void *(*task_process) (void *arg), void *arg,
+                                           void (*task_drop) (void *arg),
+                                           thread_cancel_token_t *token);
+extern int thread_pool_task_is_cancelled();
+extern int thread_pool_strand_post_cancelable(thread_strand_t *strand,
+                                              void *(*task_process) (void *arg), void *arg,
+                                              void (*task_drop) (void *arg),
+                                              thread_cancel_token_t *token);
+extern int thread_pool_add_task_labeled(void *(*task_process) (void *arg), void *arg, const char *label);
+extern void thread_pool_trace_enable(int events_per_thread);
+extern void thread_pool_trace_disable();
+extern int thread_pool_trace_dump(const char *path);
+extern thread_task_group_t *thread_pool_group_create();
+extern int thread_pool_group_spawn(thread_task_group_t *group, void *(*task_process) (void *arg), void *arg);
+extern void thread_pool_group_wait(thread_task_group_t *group);
+extern int thread_pool_group_destory(thread_task_group_t *group);
 #endif